@@ -1,14 +1,44 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <time.h>
+#include <signal.h>
+#include <getopt.h>
+#include <netdb.h>
 #include <arpa/inet.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 
-#define PORT 8080
-#define BUFFER_SIZE 4096
+#define DEFAULT_HOST "127.0.0.1"
+#define DEFAULT_PORT "8080"
+#define DEFAULT_BUFFER_SIZE 4096
+#define LINE_BUFFER_SIZE 4096
 #define CLIENT_FOLDER_BASE "client_folders/"
+#define CONFIG_FILE "client.conf"
+
+#define BATCH_BUF_SIZE (64 * 1024)
+#define DEFAULT_READER_THREADS 4
+#define MAX_READER_THREADS 64
+#define READAHEAD_FILES 256          // files read ahead of the sender
+#define INLINE_READ_MAX (1 << 20)    // larger files are streamed by the sender instead
+
+// runtime settings: built-in defaults, then CONFIG_FILE (or --config), then command-line options
+typedef struct client_config {
+    char host[256];
+    char port[16];
+    size_t buffer_size;     // file transfer chunk size
+    int reader_threads;     // parallel file reads for MPUT/SYNC
+    int sndbuf, rcvbuf;     // 0 = kernel default
+} client_config_t;
+client_config_t config = { DEFAULT_HOST, DEFAULT_PORT, DEFAULT_BUFFER_SIZE, DEFAULT_READER_THREADS, 0, 0 };
+char *xfer_buf;             // config.buffer_size bytes, shared by all transfers
 
 ssize_t send_all(int sock, const void *buf, size_t len) {
     size_t total = 0; const char *p = buf;
@@ -75,7 +105,7 @@ void do_upload(int sock, const char *username, const char *filename) {
     FILE *fp = fopen(localpath, "rb");
     if (!fp) { printf("Cannot open local file: %s\n", localpath); return; }
 
-    char buf[BUFFER_SIZE];
+    char buf[LINE_BUFFER_SIZE];
     recv_line(sock, buf, sizeof(buf));
     if (strncmp(buf, "READY", 5) != 0) { printf("%s\n", buf); fclose(fp); return; }
 
@@ -87,8 +117,8 @@ void do_upload(int sock, const char *username, const char *filename) {
     send_line(sock, msg);
 
     size_t n;
-    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
-        send_all(sock, buf, n);
+    while ((n = fread(xfer_buf, 1, config.buffer_size, fp)) > 0)
+        send_all(sock, xfer_buf, n);
     fclose(fp);
 
     recv_line(sock, buf, sizeof(buf));
@@ -96,7 +126,7 @@ void do_upload(int sock, const char *username, const char *filename) {
 }
 
 void do_download(int sock, const char *username, const char *filename) {
-    char buf[BUFFER_SIZE];
+    char buf[LINE_BUFFER_SIZE];
     recv_line(sock, buf, sizeof(buf));
     if (strncmp(buf, "ERROR", 5) == 0) { printf("%s\n", buf); return; }
 
@@ -110,9 +140,9 @@ void do_download(int sock, const char *username, const char *filename) {
 
     long remaining = size;
     while (remaining > 0) {
-        size_t chunk = (remaining > BUFFER_SIZE) ? BUFFER_SIZE : remaining;
-        if (recv_nbytes(sock, buf, chunk) != (ssize_t)chunk) break;
-        fwrite(buf, 1, chunk, fp);
+        size_t chunk = (remaining > (long)config.buffer_size) ? config.buffer_size : (size_t)remaining;
+        if (recv_nbytes(sock, xfer_buf, chunk) != (ssize_t)chunk) break;
+        fwrite(xfer_buf, 1, chunk, fp);
         remaining -= chunk;
     }
     fclose(fp);
@@ -120,8 +150,357 @@ void do_download(int sock, const char *username, const char *filename) {
     printf("Downloaded to %s\n", localpath);
 }
 
+// ---- batch transfers (MPUT / MGET / SYNC) ----
+
+typedef struct local_file {
+    char relpath[512];   // relative to the user folder, as sent on the wire
+    long long size;
+    long long mtime;
+    char *data;          // loaded by a reader thread
+    int state;           // 0 pending, 1 loaded, 2 unreadable, 3 stream from disk
+} local_file_t;
+
+typedef struct file_list {
+    local_file_t *items;
+    int count, cap;
+} file_list_t;
+
+local_file_t *file_list_add(file_list_t *l) {
+    if (l->count == l->cap) {
+        int ncap = l->cap ? l->cap * 2 : 64;
+        local_file_t *n = realloc(l->items, ncap * sizeof(local_file_t));
+        if (!n) return NULL;
+        l->items = n; l->cap = ncap;
+    }
+    local_file_t *f = &l->items[l->count++];
+    memset(f, 0, sizeof(*f));
+    return f;
+}
+
+void file_list_free(file_list_t *l) {
+    for (int i = 0; i < l->count; i++) free(l->items[i].data);
+    free(l->items);
+    l->items = NULL; l->count = l->cap = 0;
+}
+
+double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// paths in a MGET batch come from the server: relative, no "..", no empty components
+int is_safe_relpath(const char *p) {
+    if (p[0] == '\0' || p[0] == '/') return 0;
+    const char *c = p;
+    while (*c) {
+        const char *slash = strchr(c, '/');
+        size_t len = slash ? (size_t)(slash - c) : strlen(c);
+        if (len == 0) return 0;
+        if (len == 2 && c[0] == '.' && c[1] == '.') return 0;
+        if (!slash) break;
+        c = slash + 1;
+    }
+    return 1;
+}
+
+void make_parent_dirs(char *path) {
+    for (char *c = strchr(path, '/'); c; c = strchr(c + 1, '/')) {
+        *c = '\0';
+        mkdir(path, 0777);
+        *c = '/';
+    }
+}
+
+// recursively collect regular files under <user folder>/rel; -1 if that directory cannot be opened
+int collect_local_files(const char *base, const char *rel, file_list_t *out) {
+    char dir[1024];
+    if (rel[0]) snprintf(dir, sizeof(dir), "%s/%s", base, rel); else snprintf(dir, sizeof(dir), "%s", base);
+    DIR *d = opendir(dir);
+    if (!d) return -1;
+    struct dirent *e;
+    while ((e = readdir(d)) != NULL) {
+        if (e->d_name[0] == '.') continue;
+        char child[512], full[1024];
+        if (rel[0]) snprintf(child, sizeof(child), "%s/%s", rel, e->d_name); else snprintf(child, sizeof(child), "%s", e->d_name);
+        snprintf(full, sizeof(full), "%s/%s", base, child);
+        struct stat st;
+        if (stat(full, &st) != 0) continue;
+        if (S_ISDIR(st.st_mode)) { collect_local_files(base, child, out); continue; }
+        if (!S_ISREG(st.st_mode)) continue;
+        local_file_t *f = file_list_add(out);
+        if (!f) break;
+        strncpy(f->relpath, child, sizeof(f->relpath) - 1);
+        f->size = st.st_size;
+        f->mtime = st.st_mtime;
+    }
+    closedir(d);
+    return 0;
+}
+
+// reader threads load small files into memory ahead of the sender, bounded by READAHEAD_FILES
+typedef struct reader_pool {
+    const char *base;
+    file_list_t *files;
+    int next;            // next file a reader will claim
+    int sent;            // files the sender has finished with
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+} reader_pool_t;
+
+// read a file into memory; returns the state to publish (1 loaded, 2 unreadable, 3 stream from disk)
+int load_local_file(const char *base, const local_file_t *f, char **out) {
+    *out = NULL;
+    if (f->size > INLINE_READ_MAX) return 3;
+    char path[1024]; snprintf(path, sizeof(path), "%s/%s", base, f->relpath);
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return 2;
+    char *data = malloc(f->size > 0 ? f->size : 1);
+    long long got = 0;
+    while (data && got < f->size) {
+        ssize_t r = read(fd, data + got, f->size - got);
+        if (r <= 0) break;
+        got += r;
+    }
+    close(fd);
+    if (!data || got != f->size) { free(data); return 2; }
+    *out = data;
+    return 1;
+}
+
+void *reader_thread_func(void *arg) {
+    reader_pool_t *p = arg;
+    pthread_mutex_lock(&p->mutex);
+    while (p->next < p->files->count) {
+        if (p->next >= p->sent + READAHEAD_FILES) { pthread_cond_wait(&p->cond, &p->mutex); continue; }
+        int i = p->next++;
+        pthread_mutex_unlock(&p->mutex);
+        local_file_t *f = &p->files->items[i];
+        char *data;
+        int state = load_local_file(p->base, f, &data);
+        // publish under the lock so the sender never sees state without data
+        pthread_mutex_lock(&p->mutex);
+        f->data = data;
+        f->state = state;
+        pthread_cond_broadcast(&p->cond);
+    }
+    pthread_mutex_unlock(&p->mutex);
+    return NULL;
+}
+
+// coalesces batch headers and small file bodies into few large sends
+typedef struct batch_out {
+    int sock;
+    size_t len;
+    int failed;
+    char buf[BATCH_BUF_SIZE];
+} batch_out_t;
+
+void batch_out_flush(batch_out_t *o) {
+    if (o->len > 0 && !o->failed && send_all(o->sock, o->buf, o->len) < 0) o->failed = 1;
+    o->len = 0;
+}
+
+void batch_out_write(batch_out_t *o, const void *data, size_t n) {
+    if (o->len + n > sizeof(o->buf)) batch_out_flush(o);
+    if (n > sizeof(o->buf)) { if (!o->failed && send_all(o->sock, data, n) < 0) o->failed = 1; return; }
+    memcpy(o->buf + o->len, data, n);
+    o->len += n;
+}
+
+// stream a file too large to preload; always sends exactly f->size bytes
+void stream_local_file(batch_out_t *o, const char *base, local_file_t *f) {
+    char path[1024]; snprintf(path, sizeof(path), "%s/%s", base, f->relpath);
+    FILE *fp = fopen(path, "rb");
+    char *buf = xfer_buf;
+    long long remaining = f->size;
+    while (remaining > 0) {
+        size_t want = remaining > (long long)config.buffer_size ? config.buffer_size : (size_t)remaining;
+        size_t r = fp ? fread(buf, 1, want, fp) : 0;
+        if (r < want) memset(buf + r, 0, want - r);
+        batch_out_write(o, buf, want);
+        remaining -= want;
+    }
+    if (fp) fclose(fp);
+}
+
+// send the files as one BEGIN_BATCH ... END_BATCH stream, returns number of files sent
+int send_batch(int sock, const char *base, file_list_t *files) {
+    batch_out_t *o = malloc(sizeof(batch_out_t));
+    if (!o) {
+        // keep the protocol in step: the server is already waiting for a batch
+        send_all(sock, "BEGIN_BATCH\nEND_BATCH\n", 22);
+        return -1;
+    }
+    o->sock = sock; o->len = 0; o->failed = 0;
+
+    reader_pool_t pool = { base, files, 0, 0, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER };
+    pthread_t readers[MAX_READER_THREADS];
+    int nreaders = 0;
+    for (int i = 0; i < config.reader_threads && i < files->count; i++)
+        if (pthread_create(&readers[nreaders], NULL, reader_thread_func, &pool) == 0) nreaders++;
+    // without reader threads the sender loads each file itself
+
+    batch_out_write(o, "BEGIN_BATCH\n", 12);
+    int sent = 0;
+    for (int i = 0; i < files->count; i++) {
+        local_file_t *f = &files->items[i];
+        if (nreaders == 0) f->state = load_local_file(base, f, &f->data);
+        pthread_mutex_lock(&pool.mutex);
+        while (f->state == 0) pthread_cond_wait(&pool.cond, &pool.mutex);
+        pthread_mutex_unlock(&pool.mutex);
+
+        if (f->state != 2) {
+            char line[640];
+            int n = snprintf(line, sizeof(line), "FILE %lld %lld %s\n", f->size, f->mtime, f->relpath);
+            batch_out_write(o, line, (size_t)n);
+            if (f->state == 1) batch_out_write(o, f->data, (size_t)f->size);
+            else stream_local_file(o, base, f);
+            sent++;
+        } else {
+            printf("Skipping unreadable file: %s\n", f->relpath);
+        }
+        free(f->data); f->data = NULL;
+
+        pthread_mutex_lock(&pool.mutex);
+        pool.sent++;
+        pthread_cond_broadcast(&pool.cond);
+        pthread_mutex_unlock(&pool.mutex);
+    }
+    batch_out_write(o, "END_BATCH\n", 10);
+    batch_out_flush(o);
+    int failed = o->failed;
+    free(o);
+
+    for (int i = 0; i < nreaders; i++) pthread_join(readers[i], NULL);
+    pthread_mutex_destroy(&pool.mutex);
+    pthread_cond_destroy(&pool.cond);
+    return failed ? -1 : sent;
+}
+
+void print_rate(const char *what, int files, long long bytes, double start) {
+    double secs = now_seconds() - start;
+    if (secs <= 0) secs = 1e-9;
+    printf("%s %d files (%lld bytes) in %.3f s: %.0f files/sec, %.2f MB/s\n",
+           what, files, bytes, secs, files / secs, bytes / secs / (1024.0 * 1024.0));
+}
+
+// "OK: batch committed N files" without a ", M failed" suffix
+int batch_fully_committed(const char *reply) {
+    return strncmp(reply, "OK:", 3) == 0 && strstr(reply, "failed") == NULL;
+}
+
+void do_mput(int sock, const char *username, const char *dir) {
+    char buf[LINE_BUFFER_SIZE];
+    recv_line(sock, buf, sizeof(buf));
+    if (strncmp(buf, "READY", 5) != 0) { printf("%s\n", buf); return; }
+
+    double start = now_seconds();
+    char base[512]; snprintf(base, sizeof(base), "%s%s", CLIENT_FOLDER_BASE, username);
+    file_list_t files = {0};
+    int found = collect_local_files(base, strcmp(dir, ".") == 0 ? "" : dir, &files) == 0;
+    long long bytes = 0;
+    for (int i = 0; i < files.count; i++) bytes += files.items[i].size;
+
+    int sent = send_batch(sock, base, &files); // an empty batch when the directory is missing
+    file_list_free(&files);
+    recv_line(sock, buf, sizeof(buf));
+    if (!found) { printf("Local directory not found: %s/%s\n", base, dir); return; }
+    printf("%s\n", buf);
+    if (sent < 0) printf("Batch upload failed\n");
+    else if (batch_fully_committed(buf)) print_rate("Uploaded", sent, bytes, start);
+}
+
+// receive a BEGIN_BATCH ... END_BATCH stream into the user folder
+void do_mget(int sock, const char *username) {
+    char line[LINE_BUFFER_SIZE];
+    recv_line(sock, line, sizeof(line));
+    if (strcmp(line, "BEGIN_BATCH") != 0) { printf("%s\n", line); return; }
+
+    double start = now_seconds();
+    int count = 0; long long bytes = 0;
+    while (1) {
+        if (recv_line(sock, line, sizeof(line)) <= 0) { printf("Connection lost during batch\n"); return; }
+        if (strcmp(line, "END_BATCH") == 0) break;
+        long long size, mtime; int off = 0;
+        if (sscanf(line, "FILE %lld %lld %n", &size, &mtime, &off) != 2 || off == 0 || size < 0) { printf("Malformed batch entry: %s\n", line); return; }
+        const char *rel = line + off;
+        char localpath[1024];
+        snprintf(localpath, sizeof(localpath), "%s%s/%s", CLIENT_FOLDER_BASE, username, rel);
+        FILE *fp = NULL;
+        if (is_safe_relpath(rel)) {
+            make_parent_dirs(localpath);
+            fp = fopen(localpath, "wb");
+        }
+        if (!fp) printf("Cannot create local file: %s\n", localpath);
+        long long remaining = size;
+        while (remaining > 0) {
+            size_t chunk = (remaining > (long long)config.buffer_size) ? config.buffer_size : (size_t)remaining;
+            if (recv_nbytes(sock, xfer_buf, chunk) != (ssize_t)chunk) { if (fp) fclose(fp); printf("Connection lost during batch\n"); return; }
+            if (fp) fwrite(xfer_buf, 1, chunk, fp);
+            remaining -= chunk;
+        }
+        if (!fp) continue;
+        fclose(fp);
+        struct timespec ts[2] = { { 0, UTIME_OMIT }, { (time_t)mtime, 0 } };
+        utimensat(AT_FDCWD, localpath, ts, 0);
+        count++; bytes += size;
+    }
+    print_rate("Downloaded", count, bytes, start);
+}
+
+int compare_relpath(const void *a, const void *b) {
+    return strcmp(((const local_file_t *)a)->relpath, ((const local_file_t *)b)->relpath);
+}
+
+// upload only the files whose size or mtime differ from the server manifest
+void do_sync(int sock, const char *username, const char *dir) {
+    char line[LINE_BUFFER_SIZE];
+    recv_line(sock, line, sizeof(line));
+    if (strcmp(line, "BEGIN_MANIFEST") != 0) { printf("%s\n", line); return; }
+
+    double start = now_seconds();
+    char base[512]; snprintf(base, sizeof(base), "%s%s", CLIENT_FOLDER_BASE, username);
+    file_list_t local = {0};
+    int found = collect_local_files(base, strcmp(dir, ".") == 0 ? "" : dir, &local) == 0;
+    if (local.count > 1) qsort(local.items, local.count, sizeof(local_file_t), compare_relpath);
+    // mark files the server already has by reusing state: 2 = up to date
+    while (1) {
+        if (recv_line(sock, line, sizeof(line)) <= 0) { file_list_free(&local); return; }
+        if (strcmp(line, "END_MANIFEST") == 0) break;
+        long long size, mtime; int off = 0;
+        if (sscanf(line, "%lld %lld %n", &size, &mtime, &off) != 2 || off == 0) continue;
+        local_file_t key;
+        strncpy(key.relpath, line + off, sizeof(key.relpath) - 1);
+        key.relpath[sizeof(key.relpath) - 1] = '\0';
+        local_file_t *f = local.count ? bsearch(&key, local.items, local.count, sizeof(local_file_t), compare_relpath) : NULL;
+        if (f && f->size == size && f->mtime == mtime) f->state = 2;
+    }
+    file_list_t changed = {0};
+    long long bytes = 0;
+    for (int i = 0; i < local.count; i++) {
+        if (local.items[i].state == 2) continue;
+        local_file_t *f = file_list_add(&changed);
+        if (!f) break;
+        *f = local.items[i];
+        bytes += f->size;
+    }
+    int unchanged = local.count - changed.count;
+    file_list_free(&local);
+
+    recv_line(sock, line, sizeof(line));
+    if (strncmp(line, "READY", 5) != 0) { printf("%s\n", line); file_list_free(&changed); return; }
+    int sent = send_batch(sock, base, &changed);
+    file_list_free(&changed);
+    recv_line(sock, line, sizeof(line));
+    if (!found) { printf("Local directory not found: %s/%s\n", base, dir); return; }
+    printf("%s (%d already up to date)\n", line, unchanged);
+    if (sent < 0) printf("Batch upload failed\n");
+    else if (batch_fully_committed(line)) print_rate("Synced", sent, bytes, start);
+}
+
 void do_list(int sock) {
-    char buf[BUFFER_SIZE];
+    char buf[LINE_BUFFER_SIZE];
     recv_line(sock, buf, sizeof(buf));
     if (strcmp(buf, "BEGIN_LIST") != 0) { printf("%s\n", buf); return; }
     printf("Files:\n");
@@ -133,20 +512,131 @@ void do_list(int sock) {
 }
 
 void do_delete(int sock) {
-    char buf[BUFFER_SIZE];
+    char buf[LINE_BUFFER_SIZE];
     recv_line(sock, buf, sizeof(buf));
     printf("%s\n", buf);
 }
 
-int main() {
-    int sock = socket(AF_INET, SOCK_STREAM, 0);
-    struct sockaddr_in serv = {0};
-    serv.sin_family = AF_INET;
-    serv.sin_port = htons(PORT);
-    inet_pton(AF_INET, "127.0.0.1", &serv.sin_addr);
-    connect(sock, (struct sockaddr *)&serv, sizeof(serv));
+// ---- configuration ----
+
+// parse a size with an optional k/m suffix
+int parse_size(const char *v, long long *out) {
+    char *end; errno = 0;
+    long long n = strtoll(v, &end, 10);
+    if (errno || end == v || n < 0) return -1;
+    if (*end == 'k' || *end == 'K') { n *= 1024; end++; }
+    else if (*end == 'm' || *end == 'M') { n *= 1024 * 1024; end++; }
+    if (*end != '\0') return -1;
+    *out = n;
+    return 0;
+}
+
+// apply one setting by name (config file keys, or long options with '-' read as '_')
+int config_set(client_config_t *c, const char *key, const char *value) {
+    long long n = 0;
+    if (strcmp(key, "host") == 0) { snprintf(c->host, sizeof(c->host), "%s", value); return 0; }
+    if (parse_size(value, &n) != 0) { fprintf(stderr, "config: bad value for %s: %s\n", key, value); return -1; }
+    if (strcmp(key, "port") == 0 && n > 0 && n < 65536) snprintf(c->port, sizeof(c->port), "%lld", n);
+    else if (strcmp(key, "buffer_size") == 0 && n >= 512 && n <= 16 * 1024 * 1024) c->buffer_size = (size_t)n;
+    else if (strcmp(key, "reader_threads") == 0 && n >= 1 && n <= MAX_READER_THREADS) c->reader_threads = (int)n;
+    else if (strcmp(key, "sndbuf") == 0 && n <= INT_MAX) c->sndbuf = (int)n;
+    else if (strcmp(key, "rcvbuf") == 0 && n <= INT_MAX) c->rcvbuf = (int)n;
+    else { fprintf(stderr, "config: unknown setting or value out of range: %s = %s\n", key, value); return -1; }
+    return 0;
+}
+
+// "key = value" lines, '#' starts a comment; a missing file is only an error if it was asked for
+int load_config_file(client_config_t *c, const char *path, int required) {
+    FILE *f = fopen(path, "r");
+    if (!f) { if (required) { perror(path); return -1; } return 0; }
+    char line[512], key[128], value[256]; int lineno = 0, res = 0;
+    while (fgets(line, sizeof(line), f)) {
+        lineno++;
+        char *hash = strchr(line, '#'); if (hash) *hash = '\0';
+        trim_newline(line);
+        if (strspn(line, " \t") == strlen(line)) continue;
+        if (sscanf(line, " %127[^= \t] = %255s", key, value) != 2) { fprintf(stderr, "%s:%d: expected key = value\n", path, lineno); res = -1; break; }
+        if (config_set(c, key, value) != 0) { fprintf(stderr, "%s:%d: invalid setting\n", path, lineno); res = -1; break; }
+    }
+    fclose(f);
+    return res;
+}
+
+void print_usage(const char *prog) {
+    printf("Usage: %s [options]\n"
+           "  -c, --config FILE          settings file (default: " CONFIG_FILE " if present)\n"
+           "  -H, --host HOST            server address (default " DEFAULT_HOST ")\n"
+           "  -p, --port N               server port (default " DEFAULT_PORT ")\n"
+           "  -b, --buffer-size N[k|m]   file transfer buffer (default %d)\n"
+           "  -r, --reader-threads N     parallel file reads for MPUT/SYNC (default %d)\n"
+           "      --sndbuf N[k|m]        SO_SNDBUF (0 = kernel default)\n"
+           "      --rcvbuf N[k|m]        SO_RCVBUF (0 = kernel default)\n"
+           "  -h, --help\n", prog, DEFAULT_BUFFER_SIZE, DEFAULT_READER_THREADS);
+}
+
+int connect_to_server(void) {
+    struct addrinfo hints = {0}, *res, *ai;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    int err = getaddrinfo(config.host, config.port, &hints, &res);
+    if (err != 0) { fprintf(stderr, "%s: %s\n", config.host, gai_strerror(err)); return -1; }
+    int sock = -1;
+    for (ai = res; ai; ai = ai->ai_next) {
+        sock = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (sock < 0) continue;
+        if (config.sndbuf > 0) setsockopt(sock, SOL_SOCKET, SO_SNDBUF, &config.sndbuf, sizeof(config.sndbuf));
+        if (config.rcvbuf > 0) setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &config.rcvbuf, sizeof(config.rcvbuf));
+        if (connect(sock, ai->ai_addr, ai->ai_addrlen) == 0) break;
+        close(sock); sock = -1;
+    }
+    freeaddrinfo(res);
+    if (sock < 0) fprintf(stderr, "Cannot connect to %s:%s\n", config.host, config.port);
+    return sock;
+}
+
+int main(int argc, char **argv) {
+    static const struct option long_opts[] = {
+        { "config", required_argument, NULL, 'c' },
+        { "host", required_argument, NULL, 'H' },
+        { "port", required_argument, NULL, 'p' },
+        { "buffer-size", required_argument, NULL, 'b' },
+        { "reader-threads", required_argument, NULL, 'r' },
+        { "sndbuf", required_argument, NULL, 'S' },
+        { "rcvbuf", required_argument, NULL, 'R' },
+        { "help", no_argument, NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+    const char *short_opts = "c:H:p:b:r:h";
+
+    // the config file goes first so that command-line options override it
+    const char *config_path = NULL; int opt;
+    opterr = 0;
+    while ((opt = getopt_long(argc, argv, short_opts, long_opts, NULL)) != -1) if (opt == 'c') config_path = optarg;
+    if (load_config_file(&config, config_path ? config_path : CONFIG_FILE, config_path != NULL) != 0) return 1;
+    opterr = 1; optind = 1;
+    while ((opt = getopt_long(argc, argv, short_opts, long_opts, NULL)) != -1) {
+        const char *key = NULL;
+        switch (opt) {
+            case 'c': break;
+            case 'H': key = "host"; break;
+            case 'p': key = "port"; break;
+            case 'b': key = "buffer_size"; break;
+            case 'r': key = "reader_threads"; break;
+            case 'S': key = "sndbuf"; break;
+            case 'R': key = "rcvbuf"; break;
+            case 'h': print_usage(argv[0]); return 0;
+            default: print_usage(argv[0]); return 1;
+        }
+        if (key && config_set(&config, key, optarg) != 0) return 1;
+    }
+    signal(SIGPIPE, SIG_IGN); // a server that ends the session mid-batch shows up as a send error instead
+    xfer_buf = malloc(config.buffer_size);
+    if (!xfer_buf) { perror("malloc"); return 1; }
+
+    int sock = connect_to_server();
+    if (sock < 0) return 1;
 
-    char buf[BUFFER_SIZE], cmd[256], username[128];
+    char buf[LINE_BUFFER_SIZE], cmd[256], username[128];
 
     // menu
     recv_line(sock, buf, sizeof(buf)); printf("%s\n", buf);
@@ -185,6 +675,12 @@ int main() {
             do_list(sock);
         } else if (strncmp(cmd, "DELETE ", 7) == 0) {
             do_delete(sock);
+        } else if (strncmp(cmd, "MPUT ", 5) == 0) {
+            do_mput(sock, username, cmd + 5);
+        } else if (strncmp(cmd, "MGET ", 5) == 0) {
+            do_mget(sock, username);
+        } else if (strncmp(cmd, "SYNC ", 5) == 0) {
+            do_sync(sock, username, cmd + 5);
         } else if (strcmp(cmd, "QUIT") == 0) {
             recv_line(sock, buf, sizeof(buf)); printf("%s\n", buf);
             break;
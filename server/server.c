@@ -9,15 +9,48 @@
 #include <pthread.h>
 #include <errno.h>
 #include <inttypes.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sched.h>
+#include <signal.h>
+#include <getopt.h>
+#include <time.h>
 
-#define PORT 8080
-#define BUFFER_SIZE 4096
+#define DEFAULT_PORT 8080
+#define DEFAULT_BUFFER_SIZE 4096
+#define LINE_BUFFER_SIZE 4096     // protocol lines and commands
+#define CONFIG_FILE "server.conf"
 #define USERS_FILE "users.txt"
 #define SERVER_CLIENT_FOLDER "client_folders/"
 #define TMP_UPLOAD_DIR "tmp_uploads/"
 
-#define CLIENT_THREADPOOL_SIZE 4
-#define WORKER_THREADPOOL_SIZE 4
+#define DEFAULT_CLIENT_THREADS 4  // session threads per listener
+#define MIN_WORKER_THREADS 4      // workers block on disk and client sends, so keep a floor even on small hosts
+#define MIN_BUFFER_SIZE 512
+#define MAX_BUFFER_SIZE (16 * 1024 * 1024)
+
+#define LISTEN_BACKLOG 1024
+#define CONN_LOG_SIZE 4096      // pending connection log records before dropping
+
+#define BATCH_BUF_SIZE (64 * 1024)
+#define BATCH_MAX_FILES 100000                      // entries accepted per MPUT/SYNC batch
+#define BATCH_MAX_BYTES (16LL * 1024 * 1024 * 1024)  // file bytes accepted per batch
+
+// runtime settings: built-in defaults, then CONFIG_FILE (or --config), then command-line options.
+// 0 for a thread count means size it from the CPUs in the affinity mask; 0 for a socket buffer keeps the kernel default.
+typedef struct server_config {
+    int port;
+    size_t buffer_size;       // file transfer chunk size
+    int listeners;
+    int client_threads;       // per listener
+    int worker_threads;
+    int pin_cpus;
+    int sndbuf, rcvbuf;
+} server_config_t;
+server_config_t config = { DEFAULT_PORT, DEFAULT_BUFFER_SIZE, 0, DEFAULT_CLIENT_THREADS, 0, 0, 0, 0 };
+int available_cpus = 1;          // CPUs in this process's affinity mask (cpusets, taskset)
+int allowed_cpus[CPU_SETSIZE];   // their ids, so "the i-th CPU" is always one we may run on
 
 ssize_t send_all(int sock, const void *buf, size_t len) {
     size_t total = 0;
@@ -60,6 +93,11 @@ void trim_nl(char *s) {
     size_t l = strlen(s);
     while (l > 0 && (s[l-1] == '\n' || s[l-1] == '\r')) { s[l-1] = '\0'; l--; }
 }
+double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
 
 pthread_mutex_t users_mutex = PTHREAD_MUTEX_INITIALIZER;
 pthread_mutex_t files_mutex = PTHREAD_MUTEX_INITIALIZER;
@@ -99,27 +137,205 @@ void client_queue_push(client_queue_t *q, client_info_t *c) {
     pthread_cond_signal(&q->cond);
     pthread_mutex_unlock(&q->mutex);
 }
-client_info_t *client_queue_pop(client_queue_t *q) {
-    pthread_mutex_lock(&q->mutex);
-    while (q->head == NULL) pthread_cond_wait(&q->cond, &q->mutex);
-    client_info_t *c = q->head; q->head = c->next;
+// caller holds q->mutex; NULL when empty
+client_info_t *client_queue_take_locked(client_queue_t *q) {
+    client_info_t *c = q->head;
+    if (!c) return NULL;
+    q->head = c->next;
     if (q->head == NULL) q->tail = NULL;
     q->count--; c->next = NULL;
+    return c;
+}
+client_info_t *client_queue_try_pop(client_queue_t *q) {
+    pthread_mutex_lock(&q->mutex);
+    client_info_t *c = client_queue_take_locked(q);
     pthread_mutex_unlock(&q->mutex);
     return c;
 }
-client_queue_t client_queue;
 
-typedef enum { TASK_UPLOAD_MOVE, TASK_DOWNLOAD_SEND, TASK_LIST_SEND, TASK_DELETE_FILE } task_type_t;
+// one shard per SO_REUSEPORT socket: the kernel spreads connections across shards.
+// a connection goes to the first shard (its own preferred) with a spare idle session thread;
+// when every thread is busy it waits in overflow_queue for the next thread to finish a session.
+typedef struct listener {
+    int id;
+    int cpu;                      // -1 when not pinned
+    int fd;
+    client_queue_t queue;         // mutex also guards idle
+    int idle;                     // session threads waiting for a connection
+    client_info_t *free_list;     // recycled client_info_t, avoids calloc per connection
+    pthread_mutex_t free_mutex;
+} listener_t;
+listener_t *listeners;
+int listener_count;
+client_queue_t overflow_queue;
+
+// caller holds s->queue.mutex
+void shard_enqueue_locked(listener_t *s, client_info_t *c) {
+    c->next = NULL;
+    if (s->queue.tail) s->queue.tail->next = c; else s->queue.head = c;
+    s->queue.tail = c; s->queue.count++;
+    pthread_cond_signal(&s->queue.cond);
+}
+// queue c on shard s if it has an idle thread not yet claimed by an earlier queued connection
+int shard_try_place(listener_t *s, client_info_t *c) {
+    pthread_mutex_lock(&s->queue.mutex);
+    int spare = s->queue.count < s->idle;
+    if (spare) shard_enqueue_locked(s, c);
+    pthread_mutex_unlock(&s->queue.mutex);
+    return spare;
+}
+// own shard first, then any shard with a spare idle thread. each placement counts against that
+// shard's idle threads, so a burst of spills spreads over distinct threads instead of racing for one.
+void listener_dispatch(listener_t *l, client_info_t *c) {
+    for (int i = 0; i < listener_count; i++)
+        if (shard_try_place(&listeners[(l->id + i) % listener_count], c)) return;
+    client_queue_push(&overflow_queue, c);
+    // a thread that went idle after its shard was checked may already be waiting; it saw the
+    // overflow queue empty, so hand it the spilled connection (lock order: shard, then overflow)
+    for (int i = 0; i < listener_count; i++) {
+        listener_t *s = &listeners[(l->id + i) % listener_count];
+        pthread_mutex_lock(&s->queue.mutex);
+        while (s->queue.count < s->idle) {
+            client_info_t *spilled = client_queue_try_pop(&overflow_queue);
+            if (!spilled) break;
+            shard_enqueue_locked(s, spilled);
+        }
+        pthread_mutex_unlock(&s->queue.mutex);
+    }
+}
+// next connection for a session thread of shard l: its own queue first, then the overflow queue
+client_info_t *listener_next_client(listener_t *l) {
+    pthread_mutex_lock(&l->queue.mutex);
+    l->idle++;
+    while (1) {
+        client_info_t *c = client_queue_take_locked(&l->queue);
+        if (!c) c = client_queue_try_pop(&overflow_queue); // lock order: shard queue, then overflow
+        if (c) { l->idle--; pthread_mutex_unlock(&l->queue.mutex); return c; }
+        pthread_cond_wait(&l->queue.cond, &l->queue.mutex);
+    }
+}
+
+client_info_t *listener_client_alloc(listener_t *l) {
+    pthread_mutex_lock(&l->free_mutex);
+    client_info_t *c = l->free_list;
+    if (c) l->free_list = c->next;
+    pthread_mutex_unlock(&l->free_mutex);
+    if (c) return c;
+    c = calloc(1, sizeof(client_info_t));
+    if (!c) return NULL;
+    pthread_mutex_init(&c->write_mutex, NULL);
+    return c;
+}
+void listener_client_free(listener_t *l, client_info_t *c) {
+    c->sock = -1; c->logged_in = 0; c->username[0] = '\0';
+    pthread_mutex_lock(&l->free_mutex);
+    c->next = l->free_list; l->free_list = c;
+    pthread_mutex_unlock(&l->free_mutex);
+}
+void init_available_cpus(void) {
+    cpu_set_t set; CPU_ZERO(&set);
+    available_cpus = 0;
+    if (sched_getaffinity(0, sizeof(set), &set) == 0)
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) if (CPU_ISSET(cpu, &set)) allowed_cpus[available_cpus++] = cpu;
+    if (available_cpus == 0) { // no mask: fall back to every online CPU
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        available_cpus = n < 1 ? 1 : (n > CPU_SETSIZE ? CPU_SETSIZE : (int)n);
+        for (int i = 0; i < available_cpus; i++) allowed_cpus[i] = i;
+    }
+}
+// CPU for the i-th pinned thread, or -1 when pinning is off
+int pin_cpu_for(int i) { return config.pin_cpus ? allowed_cpus[i % available_cpus] : -1; }
+void pin_current_thread(int cpu) {
+    if (cpu < 0) return;
+    cpu_set_t set; CPU_ZERO(&set); CPU_SET(cpu, &set);
+    int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (err != 0) fprintf(stderr, "[server] cannot pin thread to CPU %d: %s\n", cpu, strerror(err));
+}
+
+// connection log records are formatted and printed by conn_log_thread_func,
+// off the accept path; records are dropped (and counted) if the logger falls behind
+typedef struct conn_log_entry {
+    struct sockaddr_in addr;
+    int listener;
+} conn_log_entry_t;
+typedef struct conn_log {
+    conn_log_entry_t entries[CONN_LOG_SIZE];
+    unsigned head, tail;
+    unsigned long dropped;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+} conn_log_t;
+conn_log_t conn_log = { .mutex = PTHREAD_MUTEX_INITIALIZER, .cond = PTHREAD_COND_INITIALIZER };
+
+void conn_log_push(const struct sockaddr_in *addr, int listener) {
+    pthread_mutex_lock(&conn_log.mutex);
+    if (conn_log.tail - conn_log.head == CONN_LOG_SIZE) conn_log.dropped++;
+    else {
+        conn_log_entry_t *e = &conn_log.entries[conn_log.tail++ % CONN_LOG_SIZE];
+        e->addr = *addr; e->listener = listener;
+        pthread_cond_signal(&conn_log.cond);
+    }
+    pthread_mutex_unlock(&conn_log.mutex);
+}
+void *conn_log_thread_func(void *arg) {
+    (void)arg;
+    static conn_log_entry_t batch[CONN_LOG_SIZE];
+    unsigned long reported_drops = 0;
+    while (1) {
+        pthread_mutex_lock(&conn_log.mutex);
+        while (conn_log.head == conn_log.tail) pthread_cond_wait(&conn_log.cond, &conn_log.mutex);
+        int n = 0;
+        while (conn_log.head != conn_log.tail) batch[n++] = conn_log.entries[conn_log.head++ % CONN_LOG_SIZE];
+        unsigned long dropped = conn_log.dropped;
+        pthread_mutex_unlock(&conn_log.mutex);
+        for (int i = 0; i < n; i++) {
+            char ip[INET_ADDRSTRLEN];
+            inet_ntop(AF_INET, &batch[i].addr.sin_addr, ip, sizeof(ip));
+            printf("[server] connection from %s:%d (listener %d)\n", ip, ntohs(batch[i].addr.sin_port), batch[i].listener);
+        }
+        if (dropped != reported_drops) { printf("[server] %lu connection log records dropped\n", dropped - reported_drops); reported_drops = dropped; }
+        fflush(stdout);
+    }
+    return NULL;
+}
+
+// one file of a MPUT/SYNC batch (staged in tmp_path) or of a MGET walk (tmp_path unused)
+typedef struct batch_entry {
+    char relpath[512];
+    char tmp_path[1024];
+    long long size;
+    long long mtime;
+} batch_entry_t;
+typedef struct batch_list {
+    batch_entry_t *items;
+    int count, cap;
+} batch_list_t;
+batch_entry_t *batch_list_add(batch_list_t *l) {
+    if (l->count == l->cap) {
+        int ncap = l->cap ? l->cap * 2 : 64;
+        batch_entry_t *n = realloc(l->items, ncap * sizeof(batch_entry_t));
+        if (!n) return NULL;
+        l->items = n; l->cap = ncap;
+    }
+    batch_entry_t *e = &l->items[l->count++];
+    memset(e, 0, sizeof(*e));
+    return e;
+}
+void batch_list_free(batch_list_t *l) { free(l->items); l->items = NULL; l->count = l->cap = 0; }
+
+typedef enum { TASK_UPLOAD_MOVE, TASK_DOWNLOAD_SEND, TASK_LIST_SEND, TASK_DELETE_FILE,
+               TASK_BATCH_COMMIT, TASK_BATCH_SEND, TASK_MANIFEST_SEND } task_type_t;
 typedef struct task {
     task_type_t type;
     client_info_t *client; 
     char username[128];
     char filename[512];
     char tmp_path[1024];
+    batch_list_t batch;
     pthread_mutex_t done_mutex;
     pthread_cond_t done_cond;
     int done; 
+    int status; // nonzero when the worker could not complete the task
     struct task *next;
 } task_t;
 
@@ -176,25 +392,126 @@ int ensure_server_user_folder(const char *username) {
     return 0;
 }
 
+// batch paths come from the peer: relative, no "..", no empty components
+int is_safe_relpath(const char *p) {
+    if (p[0] == '\0' || p[0] == '/') return 0;
+    const char *c = p;
+    while (*c) {
+        const char *slash = strchr(c, '/');
+        size_t len = slash ? (size_t)(slash - c) : strlen(c);
+        if (len == 0) return 0;
+        if (len == 2 && c[0] == '.' && c[1] == '.') return 0;
+        if (!slash) break;
+        c = slash + 1;
+    }
+    return 1;
+}
+// create every directory leading up to the file at path (caller holds files_mutex)
+int make_parent_dirs(char *path) {
+    for (char *c = strchr(path, '/'); c; c = strchr(c + 1, '/')) {
+        *c = '\0';
+        if (mkdir(path, 0777) != 0 && errno != EEXIST) { *c = '/'; return -1; }
+        *c = '/';
+    }
+    return 0;
+}
+// move a staged upload into place (caller holds files_mutex)
+int move_tmp_file(const char *tmp_path, const char *dest) {
+    if (rename(tmp_path, dest) == 0) return 0;
+    // fallback copy; allocate first so a failure never leaves dest truncated
+    char *buf = malloc(config.buffer_size);
+    if (!buf) return -1;
+    FILE *src = fopen(tmp_path, "rb");
+    if (!src) { free(buf); return -1; }
+    FILE *dst = fopen(dest, "wb");
+    int res = dst ? 0 : -1;
+    if (dst) {
+        size_t r;
+        while ((r = fread(buf,1,config.buffer_size,src))>0) if (fwrite(buf,1,r,dst) != r) { res = -1; break; }
+        if (fclose(dst) != 0) res = -1;
+    }
+    free(buf);
+    fclose(src);
+    unlink(tmp_path);
+    return res;
+}
+// recursively collect regular files under base/rel; relpaths are relative to base (caller holds files_mutex)
+int collect_files(const char *base, const char *rel, batch_list_t *out) {
+    char dir[2048];
+    if (rel[0]) snprintf(dir, sizeof(dir), "%s/%s", base, rel); else snprintf(dir, sizeof(dir), "%s", base);
+    DIR *d = opendir(dir);
+    if (!d) return -1;
+    struct dirent *e;
+    while ((e = readdir(d)) != NULL) {
+        if (e->d_name[0] == '.') continue;
+        char child[512], full[2048];
+        if (rel[0]) snprintf(child, sizeof(child), "%s/%s", rel, e->d_name); else snprintf(child, sizeof(child), "%s", e->d_name);
+        snprintf(full, sizeof(full), "%s/%s", base, child);
+        struct stat st;
+        if (stat(full, &st) != 0) continue;
+        if (S_ISDIR(st.st_mode)) { collect_files(base, child, out); continue; }
+        if (!S_ISREG(st.st_mode)) continue;
+        batch_entry_t *be = batch_list_add(out);
+        if (!be) break;
+        strncpy(be->relpath, child, sizeof(be->relpath) - 1);
+        be->size = st.st_size;
+        be->mtime = st.st_mtime;
+    }
+    closedir(d);
+    return 0;
+}
+void set_file_mtime(const char *path, long long mtime) {
+    struct timespec ts[2];
+    ts[0].tv_sec = 0; ts[0].tv_nsec = UTIME_OMIT;
+    ts[1].tv_sec = (time_t)mtime; ts[1].tv_nsec = 0;
+    utimensat(AT_FDCWD, path, ts, 0);
+}
+
+// coalesces batch headers and small file bodies into few large sends
+typedef struct batch_out {
+    client_info_t *client;
+    size_t len;
+    int failed;
+    char buf[BATCH_BUF_SIZE];
+} batch_out_t;
+void batch_out_flush(batch_out_t *o) {
+    if (o->len > 0 && !o->failed && client_send_bytes(o->client, o->buf, o->len) < 0) o->failed = 1;
+    o->len = 0;
+}
+void batch_out_write(batch_out_t *o, const void *data, size_t n) {
+    if (o->len + n > sizeof(o->buf)) batch_out_flush(o);
+    if (n > sizeof(o->buf)) { if (!o->failed && client_send_bytes(o->client, data, n) < 0) o->failed = 1; return; }
+    memcpy(o->buf + o->len, data, n);
+    o->len += n;
+}
+
 void worker_handle_upload_move(task_t *task) {
     char dest[2048];
     snprintf(dest, sizeof(dest), SERVER_CLIENT_FOLDER "%s/%s", task->username, task->filename);
     pthread_mutex_lock(&files_mutex);
-    if (rename(task->tmp_path, dest) != 0) { // fallback copy
-        FILE *src = fopen(task->tmp_path, "rb");
-        if (src) {
-            FILE *dst = fopen(dest, "wb");
-            if (dst) {
-                char buf[BUFFER_SIZE]; size_t r;
-                while ((r = fread(buf,1,sizeof(buf),src))>0) fwrite(buf,1,r,dst);
-                fclose(dst);
-            }
-            fclose(src);
-            unlink(task->tmp_path);
-        }
+    int res = move_tmp_file(task->tmp_path, dest);
+    pthread_mutex_unlock(&files_mutex);
+    if (res == 0) client_send_line(task->client, "OK: uploaded");
+    else { unlink(task->tmp_path); client_send_line(task->client, "ERROR: cannot store file"); }
+}
+// commit a whole staged batch under a single files_mutex hold
+void worker_handle_batch_commit(task_t *task) {
+    int committed = 0, failed = 0;
+    pthread_mutex_lock(&files_mutex);
+    for (int i = 0; i < task->batch.count; i++) {
+        batch_entry_t *e = &task->batch.items[i];
+        if (e->tmp_path[0] == '\0') { failed++; continue; }
+        char dest[2048];
+        snprintf(dest, sizeof(dest), SERVER_CLIENT_FOLDER "%s/%s", task->username, e->relpath);
+        if (make_parent_dirs(dest) != 0 || move_tmp_file(e->tmp_path, dest) != 0) { unlink(e->tmp_path); failed++; continue; }
+        set_file_mtime(dest, e->mtime);
+        committed++;
     }
     pthread_mutex_unlock(&files_mutex);
-    client_send_line(task->client, "OK: uploaded");
+    char msg[128];
+    if (failed) snprintf(msg, sizeof(msg), "OK: batch committed %d files, %d failed", committed, failed);
+    else snprintf(msg, sizeof(msg), "OK: batch committed %d files", committed);
+    client_send_line(task->client, msg);
 }
 void worker_handle_delete(task_t *task) {
     char path[2048]; snprintf(path, sizeof(path), SERVER_CLIENT_FOLDER "%s/%s", task->username, task->filename);
@@ -217,20 +534,91 @@ void worker_handle_list(task_t *task) {
 }
 void worker_handle_download(task_t *task) {
     char path[2048]; snprintf(path, sizeof(path), SERVER_CLIENT_FOLDER "%s/%s", task->username, task->filename);
+    // allocate before announcing SIZE: once it is sent the client expects exactly that many bytes
+    char *buf = malloc(config.buffer_size); size_t r;
+    if (!buf) { client_send_line(task->client, "ERROR: out of memory"); return; }
     pthread_mutex_lock(&files_mutex);
     FILE *fp = fopen(path, "rb");
-    if (!fp) { pthread_mutex_unlock(&files_mutex); client_send_line(task->client, "ERROR: file not found"); return; }
+    if (!fp) { pthread_mutex_unlock(&files_mutex); free(buf); client_send_line(task->client, "ERROR: file not found"); return; }
     fseek(fp,0,SEEK_END); long size = ftell(fp); fseek(fp,0,SEEK_SET);
     char size_line[64]; snprintf(size_line, sizeof(size_line), "SIZE %ld", size);
     client_send_line(task->client, size_line);
-    char buf[BUFFER_SIZE]; size_t r;
-    while ((r = fread(buf,1,sizeof(buf),fp))>0) { client_send_bytes(task->client, buf, r); }
+    while ((r = fread(buf,1,config.buffer_size,fp))>0) { client_send_bytes(task->client, buf, r); }
+    free(buf);
     fclose(fp); pthread_mutex_unlock(&files_mutex);
     client_send_line(task->client, "END_OF_FILE");
 }
 
+void worker_handle_manifest(task_t *task) {
+    char base[1024]; snprintf(base, sizeof(base), SERVER_CLIENT_FOLDER "%s", task->username);
+    const char *rel = strcmp(task->filename, ".") == 0 ? "" : task->filename;
+    batch_list_t files = {0};
+    pthread_mutex_lock(&files_mutex);
+    collect_files(base, rel, &files);
+    pthread_mutex_unlock(&files_mutex);
+    batch_out_t *o = malloc(sizeof(batch_out_t));
+    if (!o) { batch_list_free(&files); client_send_line(task->client, "ERROR: out of memory"); task->status = -1; return; }
+    o->client = task->client; o->len = 0; o->failed = 0;
+    batch_out_write(o, "BEGIN_MANIFEST\n", 15);
+    for (int i = 0; i < files.count; i++) {
+        char line[640];
+        int n = snprintf(line, sizeof(line), "%lld %lld %s\n", files.items[i].size, files.items[i].mtime, files.items[i].relpath);
+        batch_out_write(o, line, (size_t)n);
+    }
+    batch_out_write(o, "END_MANIFEST\n", 13);
+    batch_out_flush(o);
+    if (o->failed) task->status = -1;
+    free(o);
+    batch_list_free(&files);
+}
+// stream every file under the requested directory as one batch
+void worker_handle_batch_send(task_t *task) {
+    char base[1024]; snprintf(base, sizeof(base), SERVER_CLIENT_FOLDER "%s", task->username);
+    const char *rel = strcmp(task->filename, ".") == 0 ? "" : task->filename;
+    batch_list_t files = {0};
+    batch_out_t *o = malloc(sizeof(batch_out_t));
+    char *buf = malloc(config.buffer_size);
+    if (!o || !buf) { free(o); free(buf); client_send_line(task->client, "ERROR: out of memory"); return; }
+    o->client = task->client; o->len = 0; o->failed = 0;
+    // only the walk needs files_mutex; a slow client must not stall everyone else while we stream
+    pthread_mutex_lock(&files_mutex);
+    int found = collect_files(base, rel, &files) == 0;
+    pthread_mutex_unlock(&files_mutex);
+    if (!found) { free(o); free(buf); client_send_line(task->client, "ERROR: directory not found"); return; }
+    batch_out_write(o, "BEGIN_BATCH\n", 12);
+    for (int i = 0; i < files.count && !o->failed; i++) {
+        batch_entry_t *e = &files.items[i];
+        char path[2048]; snprintf(path, sizeof(path), "%s/%s", base, e->relpath);
+        FILE *fp = fopen(path, "rb");
+        if (!fp) continue;
+        // commits replace files by rename, so the open handle is stable: announce its size and mtime,
+        // not the ones recorded during the walk
+        struct stat st;
+        if (fstat(fileno(fp), &st) != 0 || !S_ISREG(st.st_mode)) { fclose(fp); continue; }
+        e->size = st.st_size; e->mtime = st.st_mtime;
+        char line[640];
+        int n = snprintf(line, sizeof(line), "FILE %lld %lld %s\n", e->size, e->mtime, e->relpath);
+        batch_out_write(o, line, (size_t)n);
+        // only an in-place truncation can make the read come up short; pad as a last resort to keep framing
+        long long remaining = e->size;
+        while (remaining > 0) {
+            size_t want = remaining > (long long)config.buffer_size ? config.buffer_size : (size_t)remaining;
+            size_t r = fread(buf, 1, want, fp);
+            if (r < want) memset(buf + r, 0, want - r);
+            batch_out_write(o, buf, want);
+            remaining -= want;
+        }
+        fclose(fp);
+    }
+    free(buf);
+    batch_out_write(o, "END_BATCH\n", 10);
+    batch_out_flush(o);
+    free(o);
+    batch_list_free(&files);
+}
+
 void *worker_thread_func(void *arg) {
-    (void)arg;
+    pin_current_thread((int)(intptr_t)arg);
     while (1) {
         task_t *task = task_queue_pop(&task_queue);
         if (!task) continue;
@@ -239,6 +627,9 @@ void *worker_thread_func(void *arg) {
             case TASK_DELETE_FILE: worker_handle_delete(task); break;
             case TASK_LIST_SEND: worker_handle_list(task); break;
             case TASK_DOWNLOAD_SEND: worker_handle_download(task); break;
+            case TASK_BATCH_COMMIT: worker_handle_batch_commit(task); break;
+            case TASK_BATCH_SEND: worker_handle_batch_send(task); break;
+            case TASK_MANIFEST_SEND: worker_handle_manifest(task); break;
             default: client_send_line(task->client, "ERROR: unknown task"); break;
         }
         // signal completion to waiting client thread (do NOT free task here)
@@ -251,10 +642,118 @@ void *worker_thread_func(void *arg) {
 }
 
 void ensure_tmp_dir() { struct stat st; if (stat(TMP_UPLOAD_DIR, &st) == -1) mkdir(TMP_UPLOAD_DIR, 0777); }
-void generate_tmp_path(char *out, size_t outlen) { static int seq=0; pid_t pid=getpid(); int s = _sync_add_and_fetch(&seq,1); snprintf(out,outlen, TMP_UPLOAD_DIR "upload%d_%d.tmp", (int)pid, s); }
+void generate_tmp_path(char *out, size_t outlen) { static int seq=0; pid_t pid=getpid(); int s = __sync_add_and_fetch(&seq,1); snprintf(out,outlen, TMP_UPLOAD_DIR "upload%d_%d.tmp", (int)pid, s); }
+
+// hand a task to the worker pool and block until it has finished
+void submit_task_and_wait(task_t *t) {
+    pthread_mutex_init(&t->done_mutex, NULL);
+    pthread_cond_init(&t->done_cond, NULL);
+    t->done = 0;
+    task_queue_push(&task_queue, t);
+    pthread_mutex_lock(&t->done_mutex);
+    while (!t->done) pthread_cond_wait(&t->done_cond, &t->done_mutex);
+    pthread_mutex_unlock(&t->done_mutex);
+    pthread_cond_destroy(&t->done_cond);
+    pthread_mutex_destroy(&t->done_mutex);
+}
+
+void batch_discard(batch_list_t *l) {
+    for (int i = 0; i < l->count; i++) if (l->items[i].tmp_path[0]) unlink(l->items[i].tmp_path);
+    batch_list_free(l);
+}
+// buffered reads over the session's transfer buffer: a batch of small files is mostly short
+// header lines, which recv_line would fetch one byte per syscall. the client sends nothing after
+// END_BATCH until it has the server's reply, so reading ahead never consumes the next command.
+typedef struct batch_reader {
+    int sock;
+    char *buf;
+    size_t cap, pos, len;
+} batch_reader_t;
+int batch_reader_fill(batch_reader_t *br) {
+    ssize_t r = recv(br->sock, br->buf, br->cap, 0);
+    if (r <= 0) return -1;
+    br->pos = 0; br->len = (size_t)r;
+    return 0;
+}
+// like recv_line: strips '\r', returns -1 on a closed socket or a line longer than maxlen - 1
+int batch_reader_line(batch_reader_t *br, char *line, size_t maxlen) {
+    size_t i = 0;
+    while (1) {
+        if (br->pos == br->len && batch_reader_fill(br) != 0) return -1;
+        char c = br->buf[br->pos++];
+        if (c == '\n') break;
+        if (c == '\r') continue;
+        if (i + 1 >= maxlen) return -1;
+        line[i++] = c;
+    }
+    line[i] = '\0';
+    return 0;
+}
+
+// read a BEGIN_BATCH ... END_BATCH stream, staging every file under TMP_UPLOAD_DIR.
+// entries with unsafe or overlong paths, or whose temp file could not be written, are drained
+// and left with an empty tmp_path so the commit counts them as failed.
+// returns -1 on a broken stream, -2 when the batch exceeds BATCH_MAX_FILES or BATCH_MAX_BYTES.
+int receive_batch(client_info_t *client, batch_list_t *out, char *xfer_buf) {
+    char line[LINE_BUFFER_SIZE];
+    batch_reader_t br = { client->sock, xfer_buf, config.buffer_size, 0, 0 };
+    long long total = 0;
+    if (batch_reader_line(&br, line, sizeof(line)) != 0) return -1;
+    if (strcmp(line, "BEGIN_BATCH") != 0) return -1;
+    ensure_tmp_dir();
+    while (1) {
+        if (batch_reader_line(&br, line, sizeof(line)) != 0) return -1;
+        if (strcmp(line, "END_BATCH") == 0) return 0;
+        long long size, mtime; int off = 0;
+        if (sscanf(line, "FILE %lld %lld %n", &size, &mtime, &off) != 2 || off == 0 || size < 0) return -1;
+        if (out->count >= BATCH_MAX_FILES || size > BATCH_MAX_BYTES - total) return -2;
+        total += size;
+        batch_entry_t *e = batch_list_add(out);
+        if (!e) return -1;
+        e->size = size; e->mtime = mtime;
+        FILE *tf = NULL;
+        if (strlen(line + off) < sizeof(e->relpath)) {
+            strcpy(e->relpath, line + off);
+            if (is_safe_relpath(e->relpath)) {
+                generate_tmp_path(e->tmp_path, sizeof(e->tmp_path));
+                tf = fopen(e->tmp_path, "wb");
+                if (!tf) e->tmp_path[0] = '\0';
+            }
+        }
+        int write_failed = 0;
+        long long remaining = size;
+        while (remaining > 0) {
+            if (br.pos == br.len && batch_reader_fill(&br) != 0) { if (tf) fclose(tf); return -1; }
+            size_t n = br.len - br.pos;
+            if ((long long)n > remaining) n = (size_t)remaining;
+            if (tf && !write_failed && fwrite(br.buf + br.pos, 1, n, tf) != n) write_failed = 1;
+            br.pos += n;
+            remaining -= n;
+        }
+        if (tf && (fclose(tf) != 0 || write_failed)) { unlink(e->tmp_path); e->tmp_path[0] = '\0'; }
+    }
+}
+// receive one batch and commit it through a single worker task
+int receive_and_commit_batch(client_info_t *client, char *xfer_buf) {
+    task_t *t = calloc(1, sizeof(task_t));
+    int res = receive_batch(client, &t->batch, xfer_buf);
+    if (res != 0) {
+        batch_discard(&t->batch); free(t);
+        // the rest of the stream cannot be skipped reliably, so the session ends either way
+        client_send_line(client, res == -2 ? "ERROR: batch too large" : "ERROR: transfer failed");
+        return -1;
+    }
+    t->type = TASK_BATCH_COMMIT;
+    t->client = client;
+    strncpy(t->username, client->username, sizeof(t->username));
+    submit_task_and_wait(t);
+    batch_list_free(&t->batch);
+    free(t);
+    return 0;
+}
 
 void handle_client_session_direct(client_info_t *client) {
-    char buf[BUFFER_SIZE];
+    char buf[LINE_BUFFER_SIZE];
     // menu
     client_send_line(client, "1. Sign Up");
     client_send_line(client, "2. Login");
@@ -276,7 +775,7 @@ void handle_client_session_direct(client_info_t *client) {
     }
 
     while (1) {
-        client_send_line(client, "Commands: UPLOAD <file>, DOWNLOAD <file>, LIST, DELETE <file>, QUIT");
+        client_send_line(client, "Commands: UPLOAD <file>, DOWNLOAD <file>, LIST, DELETE <file>, MPUT <dir>, MGET <dir>, SYNC <dir>, QUIT");
         client_send_line(client, "Enter command:");
         ssize_t r = recv_line(client->sock, buf, sizeof(buf));
         if (r <= 0) break;
@@ -291,7 +790,7 @@ void handle_client_session_direct(client_info_t *client) {
             char tmp_path[1024]; generate_tmp_path(tmp_path, sizeof(tmp_path));
             FILE *tf = fopen(tmp_path,"wb");
             if (!tf) { client_send_line(client,"ERROR: cannot create temp file"); continue; }
-            unsigned long long remaining = size; char b[BUFFER_SIZE]; // intentional typo prevention
+            unsigned long long remaining = size; char b[LINE_BUFFER_SIZE]; // intentional typo prevention
         }
         // *** NOTE: the code above had an accidental scratch ; we'll continue with correct implementation below ***
         break;
@@ -300,8 +799,9 @@ void handle_client_session_direct(client_info_t *client) {
 }
 
 
-void handle_client_session(client_info_t *client) {
-    char buf[BUFFER_SIZE];
+// xfer_buf is the calling session thread's config.buffer_size transfer buffer
+void handle_client_session(client_info_t *client, char *xfer_buf) {
+    char buf[LINE_BUFFER_SIZE];
 
     client_send_line(client, "1. Sign Up");
     client_send_line(client, "2. Login");
@@ -331,7 +831,7 @@ void handle_client_session(client_info_t *client) {
 
     // main loop
     while (1) {
-        client_send_line(client, "Commands: UPLOAD <file>, DOWNLOAD <file>, LIST, DELETE <file>, QUIT");
+        client_send_line(client, "Commands: UPLOAD <file>, DOWNLOAD <file>, LIST, DELETE <file>, MPUT <dir>, MGET <dir>, SYNC <dir>, QUIT");
         client_send_line(client, "Enter command:");
         ssize_t r = recv_line(client->sock, buf, sizeof(buf));
         if (r <= 0) break;
@@ -353,9 +853,9 @@ void handle_client_session(client_info_t *client) {
             FILE *tf = fopen(tmp_path, "wb");
             if (!tf) { client_send_line(client, "ERROR: cannot create temp file"); continue; }
             unsigned long long remaining = size;
-            char buffer[BUFFER_SIZE];
+            char *buffer = xfer_buf;
             while (remaining > 0) {
-                size_t toread = (remaining > sizeof(buffer)) ? sizeof(buffer) : (size_t)remaining;
+                size_t toread = (remaining > config.buffer_size) ? config.buffer_size : (size_t)remaining;
                 if (recv_nbytes(client->sock, buffer, toread) != (ssize_t)toread) {
                     fclose(tf); unlink(tmp_path); client_send_line(client, "ERROR: transfer failed"); goto client_disconnect;
                 }
@@ -442,6 +942,28 @@ void handle_client_session(client_info_t *client) {
             pthread_mutex_destroy(&t->done_mutex);
             free(t);
         }
+        else if (strncmp(buf, "MPUT ", 5) == 0) {
+            client_send_line(client, "READY");
+            if (receive_and_commit_batch(client, xfer_buf) != 0) goto client_disconnect;
+        }
+        else if (strncmp(buf, "MGET ", 5) == 0 || strncmp(buf, "SYNC ", 5) == 0) {
+            char dir[512];
+            if (sscanf(buf + 5, "%511s", dir) != 1 || (strcmp(dir, ".") != 0 && !is_safe_relpath(dir))) { client_send_line(client, "ERROR: invalid directory"); continue; }
+            int is_sync = buf[0] == 'S';
+            task_t *t = calloc(1,sizeof(task_t));
+            t->type = is_sync ? TASK_MANIFEST_SEND : TASK_BATCH_SEND;
+            t->client = client;
+            strncpy(t->username, client->username, sizeof(t->username));
+            strncpy(t->filename, dir, sizeof(t->filename));
+            submit_task_and_wait(t);
+            int status = t->status;
+            free(t);
+            if (is_sync && status == 0) {
+                // client diffs the manifest and uploads only what changed
+                client_send_line(client, "READY");
+                if (receive_and_commit_batch(client, xfer_buf) != 0) goto client_disconnect;
+            }
+        }
         else if (strcmp(buf, "QUIT") == 0) {
             client_send_line(client, "Goodbye");
             break;
@@ -456,50 +978,359 @@ client_disconnect:
 }
 
 void *client_thread_func(void *arg) {
-    (void)arg;
+    listener_t *l = arg;
+    pin_current_thread(l->cpu);
+    // one transfer buffer per session thread, so memory scales with the pool, not with queued connections
+    char *xfer_buf = malloc(config.buffer_size);
+    if (!xfer_buf) { perror("session thread buffer"); return NULL; }
     while (1) {
-        client_info_t *client = client_queue_pop(&client_queue);
+        client_info_t *client = listener_next_client(l);
         if (!client) continue;
-        handle_client_session(client);
-        pthread_mutex_destroy(&client->write_mutex);
-        free(client);
+        handle_client_session(client, xfer_buf);
+        listener_client_free(l, client);
     }
     return NULL;
 }
 
+// SO_REUSEPORT would let a second server on the same port bind silently and take a share of the
+// connections, so first bind the port once without it; this fails if anyone is already listening.
+// (a second instance starting in the window between this probe and the real binds is not detected)
+int port_in_use(void) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) { perror("socket"); return 1; }
+    int opt = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    struct sockaddr_in addr = {0}; addr.sin_family = AF_INET; addr.sin_port = htons(config.port); addr.sin_addr.s_addr = INADDR_ANY;
+    int res = bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+    if (res < 0) perror("bind");
+    close(fd);
+    return res < 0;
+}
+
+int open_listen_socket(void) {
+    // non-blocking so the accept loop can drain the whole backlog and go back to poll
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) { perror("socket"); return -1; }
+    int opt = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0) { perror("SO_REUSEPORT"); close(fd); return -1; }
+    // SO_RCVBUF has to be set before listen() for the window scale to take effect; accepted sockets inherit both
+    if (config.sndbuf > 0) setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &config.sndbuf, sizeof(config.sndbuf));
+    if (config.rcvbuf > 0) setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &config.rcvbuf, sizeof(config.rcvbuf));
+    struct sockaddr_in addr = {0}; addr.sin_family = AF_INET; addr.sin_port = htons(config.port); addr.sin_addr.s_addr = INADDR_ANY;
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) { perror("bind"); close(fd); return -1; }
+    if (listen(fd, LISTEN_BACKLOG) < 0) { perror("listen"); close(fd); return -1; }
+    return fd;
+}
+
 void *accept_thread_func(void *arg) {
-    (void)arg;
-    int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (listen_fd < 0) { perror("socket"); exit(1); }
-    int opt = 1; setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
-    struct sockaddr_in addr = {0}; addr.sin_family = AF_INET; addr.sin_port = htons(PORT); addr.sin_addr.s_addr = INADDR_ANY;
-    if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) { perror("bind"); exit(1); }
-    if (listen(listen_fd, 128) < 0) { perror("listen"); exit(1); }
-    printf("[server] listening on %d\n", PORT);
+    listener_t *l = arg;
+    pin_current_thread(l->cpu);
+    struct pollfd pfd = { .fd = l->fd, .events = POLLIN };
     while (1) {
-        struct sockaddr_in cli; socklen_t len = sizeof(cli);
-        int client_sock = accept(listen_fd, (struct sockaddr *)&cli, &len);
-        if (client_sock < 0) { perror("accept"); continue; }
-        client_info_t *c = calloc(1,sizeof(client_info_t));
-        c->sock = client_sock; pthread_mutex_init(&c->write_mutex, NULL); c->logged_in = 0; c->username[0] = '\0';
-        client_queue_push(&client_queue, c);
-        printf("[server] connection from %s:%d\n", inet_ntoa(cli.sin_addr), ntohs(cli.sin_port));
-    }
-    close(listen_fd);
+        if (poll(&pfd, 1, -1) < 0) { if (errno != EINTR) perror("poll"); continue; }
+        while (1) {
+            struct sockaddr_in cli; socklen_t len = sizeof(cli);
+            // sessions use blocking I/O, so accepted sockets are left blocking
+            int client_sock = accept4(l->fd, (struct sockaddr *)&cli, &len, SOCK_CLOEXEC);
+            if (client_sock < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+                if (errno == EINTR || errno == ECONNABORTED) continue;
+                perror("accept4");
+                if (errno == EMFILE || errno == ENFILE) usleep(10000); // let sessions release fds
+                break;
+            }
+            client_info_t *c = listener_client_alloc(l);
+            if (!c) { close(client_sock); continue; }
+            c->sock = client_sock;
+            listener_dispatch(l, c);
+            conn_log_push(&cli, l->id);
+        }
+    }
+    close(l->fd);
+    return NULL;
+}
+
+// ---- configuration ----
+
+// parse a size with an optional k/m suffix
+int parse_size(const char *v, long long *out) {
+    char *end; errno = 0;
+    long long n = strtoll(v, &end, 10);
+    if (errno || end == v || n < 0) return -1;
+    if (*end == 'k' || *end == 'K') { n *= 1024; end++; }
+    else if (*end == 'm' || *end == 'M') { n *= 1024 * 1024; end++; }
+    if (*end != '\0') return -1;
+    *out = n;
+    return 0;
+}
+// apply one setting by name (config file keys, or long options with '-' read as '_')
+int config_set(server_config_t *c, const char *key, const char *value) {
+    long long n;
+    if (parse_size(value, &n) != 0) { fprintf(stderr, "config: bad value for %s: %s\n", key, value); return -1; }
+    if (strcmp(key, "port") == 0 && n > 0 && n < 65536) c->port = (int)n;
+    else if (strcmp(key, "buffer_size") == 0 && n >= MIN_BUFFER_SIZE && n <= MAX_BUFFER_SIZE) c->buffer_size = (size_t)n;
+    else if (strcmp(key, "listeners") == 0 && n <= 1024) c->listeners = (int)n;
+    else if (strcmp(key, "client_threads") == 0 && n <= 1024) c->client_threads = (int)n;
+    else if (strcmp(key, "worker_threads") == 0 && n <= 1024) c->worker_threads = (int)n;
+    else if (strcmp(key, "pin_cpus") == 0 && n <= 1) c->pin_cpus = (int)n;
+    else if (strcmp(key, "sndbuf") == 0 && n <= INT_MAX) c->sndbuf = (int)n;
+    else if (strcmp(key, "rcvbuf") == 0 && n <= INT_MAX) c->rcvbuf = (int)n;
+    else { fprintf(stderr, "config: unknown setting or value out of range: %s = %s\n", key, value); return -1; }
+    return 0;
+}
+// "key = value" lines, '#' starts a comment; a missing file is only an error if it was asked for
+int load_config_file(server_config_t *c, const char *path, int required) {
+    FILE *f = fopen(path, "r");
+    if (!f) { if (required) { perror(path); return -1; } return 0; }
+    char line[512], key[128], value[128]; int lineno = 0, res = 0;
+    while (fgets(line, sizeof(line), f)) {
+        lineno++;
+        char *hash = strchr(line, '#'); if (hash) *hash = '\0';
+        trim_nl(line);
+        if (strspn(line, " \t") == strlen(line)) continue;
+        if (sscanf(line, " %127[^= \t] = %127s", key, value) != 2) { fprintf(stderr, "%s:%d: expected key = value\n", path, lineno); res = -1; break; }
+        if (config_set(c, key, value) != 0) { fprintf(stderr, "%s:%d: invalid setting\n", path, lineno); res = -1; break; }
+    }
+    fclose(f);
+    return res;
+}
+// fill in the "auto" (0) thread counts from the CPUs this process may run on
+void config_resolve(server_config_t *c) {
+    if (c->listeners <= 0) c->listeners = available_cpus;
+    if (c->client_threads <= 0) c->client_threads = DEFAULT_CLIENT_THREADS;
+    if (c->worker_threads <= 0) c->worker_threads = available_cpus > MIN_WORKER_THREADS ? available_cpus : MIN_WORKER_THREADS;
+}
+void print_usage(const char *prog) {
+    printf("Usage: %s [options]\n"
+           "  -c, --config FILE         settings file (default: " CONFIG_FILE " if present)\n"
+           "  -p, --port N              listen port (default %d)\n"
+           "  -b, --buffer-size N[k|m]  file transfer buffer (default %d)\n"
+           "  -l, --listeners N         SO_REUSEPORT listener shards (0 = one per available CPU)\n"
+           "      --client-threads N    session threads per listener (default %d)\n"
+           "  -w, --worker-threads N    file worker threads (0 = one per available CPU, at least %d)\n"
+           "      --pin-cpus 0|1        pin listener, session and worker threads to CPUs\n"
+           "      --sndbuf N[k|m]       SO_SNDBUF for client sockets (0 = kernel default)\n"
+           "      --rcvbuf N[k|m]       SO_RCVBUF for client sockets (0 = kernel default)\n"
+           "      --sweep               benchmark transfer buffer sizes on this host and exit\n"
+           "  -h, --help\n", prog, DEFAULT_PORT, DEFAULT_BUFFER_SIZE, DEFAULT_CLIENT_THREADS, MIN_WORKER_THREADS);
+}
+
+// ---- sweep mode ----
+
+#define SWEEP_BYTES (128LL * 1024 * 1024)  // moved per run, split across streams
+#define SWEEP_REPEATS 3                    // runs per configuration; the median is kept
+#define SWEEP_TOLERANCE 0.05               // prefer cheaper settings within 5% of the best
+
+// one loopback stream: a sender pushing bytes and a receiver staging them to disk the way a
+// session thread receives an UPLOAD/MPUT, so the stream count maps onto session threads
+typedef struct sweep_stream {
+    int send_fd, recv_fd;
+    size_t buffer_size;
+    long long bytes;
+    int send_failed, recv_failed;   // each written only by its own thread, read after join
+} sweep_stream_t;
+
+void *sweep_sender_func(void *arg) {
+    sweep_stream_t *st = arg;
+    char *buf = calloc(1, st->buffer_size);
+    if (!buf) st->send_failed = 1;
+    long long remaining = st->bytes;
+    while (buf && remaining > 0) {
+        size_t n = remaining > (long long)st->buffer_size ? st->buffer_size : (size_t)remaining;
+        if (send_all(st->send_fd, buf, n) < 0) { st->send_failed = 1; break; }
+        remaining -= n;
+    }
+    free(buf);
+    shutdown(st->send_fd, SHUT_WR);
+    return NULL;
+}
+void *sweep_receiver_func(void *arg) {
+    sweep_stream_t *st = arg;
+    char tmp_path[1024]; generate_tmp_path(tmp_path, sizeof(tmp_path));
+    FILE *tf = fopen(tmp_path, "wb");
+    char *buf = malloc(st->buffer_size);
+    if (!tf || !buf) st->recv_failed = 1;
+    ssize_t r;
+    char drain[512];
+    // keep draining after a failure so the sender is never left blocked on a full socket
+    while ((r = recv(st->recv_fd, buf ? buf : drain, buf ? st->buffer_size : sizeof(drain), 0)) > 0)
+        if (!st->recv_failed) fwrite(buf, 1, (size_t)r, tf);
+    free(buf);
+    if (tf) fclose(tf);
+    unlink(tmp_path);
     return NULL;
 }
+// MB/s moving SWEEP_BYTES over `streams` concurrent loopback connections, or -1 on error
+double sweep_run(size_t buffer_size, int streams) {
+    int lfd = socket(AF_INET, SOCK_STREAM, 0);
+    if (lfd < 0) return -1;
+    if (config.rcvbuf > 0) setsockopt(lfd, SOL_SOCKET, SO_RCVBUF, &config.rcvbuf, sizeof(config.rcvbuf));
+    struct sockaddr_in addr = {0}; addr.sin_family = AF_INET; addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t alen = sizeof(addr);
+    if (bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(lfd, streams) < 0 ||
+        getsockname(lfd, (struct sockaddr *)&addr, &alen) < 0) { close(lfd); return -1; }
+
+    sweep_stream_t *st = calloc(streams, sizeof(sweep_stream_t));
+    pthread_t *threads = calloc(2 * streams, sizeof(pthread_t));
+    char *started = calloc(2 * streams, 1);
+    int opened = 0, ok = st && threads && started;
+    for (int i = 0; ok && i < streams; i++) {
+        st[i].buffer_size = buffer_size;
+        st[i].bytes = SWEEP_BYTES / streams;
+        st[i].send_fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (config.sndbuf > 0) setsockopt(st[i].send_fd, SOL_SOCKET, SO_SNDBUF, &config.sndbuf, sizeof(config.sndbuf));
+        if (connect(st[i].send_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) { close(st[i].send_fd); ok = 0; break; }
+        st[i].recv_fd = accept(lfd, NULL, NULL);
+        if (st[i].recv_fd < 0) { close(st[i].send_fd); ok = 0; break; }
+        opened++;
+    }
+    close(lfd);
+    double mbps = -1;
+    if (ok) {
+        double start = now_seconds();
+        // a stream whose receiver did not start never gets a sender; one whose sender did not
+        // start has its write side shut so the receiver sees EOF instead of blocking forever
+        for (int i = 0; i < streams; i++) {
+            started[2 * i] = pthread_create(&threads[2 * i], NULL, sweep_receiver_func, &st[i]) == 0;
+            if (started[2 * i])
+                started[2 * i + 1] = pthread_create(&threads[2 * i + 1], NULL, sweep_sender_func, &st[i]) == 0;
+            if (!started[2 * i + 1]) { shutdown(st[i].send_fd, SHUT_WR); ok = 0; }
+        }
+        for (int i = 0; i < 2 * streams; i++) if (started[i]) pthread_join(threads[i], NULL);
+        double secs = now_seconds() - start;
+        for (int i = 0; i < streams; i++) if (st[i].send_failed || st[i].recv_failed) ok = 0;
+        if (ok && secs > 0) mbps = (SWEEP_BYTES / streams * streams) / secs / (1024.0 * 1024.0);
+    }
+    for (int i = 0; i < opened; i++) { close(st[i].send_fd); close(st[i].recv_fd); }
+    free(st); free(threads); free(started);
+    return mbps;
+}
+int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+int run_sweep(void) {
+    static const size_t buffer_sizes[] = { 4096, 16 * 1024, 64 * 1024, 256 * 1024, 1024 * 1024 };
+    int nbuf = sizeof(buffer_sizes) / sizeof(buffer_sizes[0]);
+    int thread_counts[16], nthreads = 0;    // concurrent upload streams
+    for (int t = 1; t <= 2 * available_cpus && nthreads < 15; t *= 2) thread_counts[nthreads++] = t;
+    if (thread_counts[nthreads - 1] < available_cpus * 2 && nthreads < 16) thread_counts[nthreads++] = available_cpus * 2;
+
+    ensure_tmp_dir();
+    printf("[sweep] %d available CPUs, %lld MB per run, median of %d runs, sndbuf=%d rcvbuf=%d\n",
+           available_cpus, SWEEP_BYTES >> 20, SWEEP_REPEATS, config.sndbuf, config.rcvbuf);
+    printf("%12s %8s %12s\n", "buffer_size", "streams", "MB/s");
+    double results[8][16], best = 0;
+    for (int b = 0; b < nbuf; b++) {
+        for (int t = 0; t < nthreads; t++) {
+            double runs[SWEEP_REPEATS];
+            for (int r = 0; r < SWEEP_REPEATS; r++) runs[r] = sweep_run(buffer_sizes[b], thread_counts[t]);
+            qsort(runs, SWEEP_REPEATS, sizeof(double), compare_double);
+            results[b][t] = runs[0] < 0 ? -1 : runs[SWEEP_REPEATS / 2];
+            if (results[b][t] < 0) printf("%12zu %8d %12s\n", buffer_sizes[b], thread_counts[t], "failed");
+            else printf("%12zu %8d %12.1f\n", buffer_sizes[b], thread_counts[t], results[b][t]);
+            fflush(stdout);
+            if (results[b][t] > best) best = results[b][t];
+        }
+    }
+    if (best <= 0) { fprintf(stderr, "[sweep] no run succeeded\n"); return 1; }
+    // smallest buffer whose best stream count comes close to the overall best. only buffer_size is
+    // recommended: the stream counts show how uploads scale, but session threads are held by idle
+    // sessions and workers serialize on files_mutex, so neither pool size follows from this measurement.
+    for (int b = 0; b < nbuf; b++) {
+        int best_t = 0;
+        for (int t = 1; t < nthreads; t++) if (results[b][t] > results[b][best_t]) best_t = t;
+        if (results[b][best_t] < best * (1.0 - SWEEP_TOLERANCE)) continue;
+        printf("[sweep] recommended setting (%.1f MB/s with %d concurrent uploads, best %.1f MB/s):\n",
+               results[b][best_t], thread_counts[best_t], best);
+        printf("buffer_size = %zu\n", buffer_sizes[b]);
+        return 0;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    static const struct option long_opts[] = {
+        { "config", required_argument, NULL, 'c' },
+        { "port", required_argument, NULL, 'p' },
+        { "buffer-size", required_argument, NULL, 'b' },
+        { "listeners", required_argument, NULL, 'l' },
+        { "client-threads", required_argument, NULL, 'C' },
+        { "worker-threads", required_argument, NULL, 'w' },
+        { "pin-cpus", required_argument, NULL, 'P' },
+        { "sndbuf", required_argument, NULL, 'S' },
+        { "rcvbuf", required_argument, NULL, 'R' },
+        { "sweep", no_argument, NULL, 'x' },
+        { "help", no_argument, NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+    const char *short_opts = "c:p:b:l:w:h";
+    init_available_cpus();
+
+    // the config file goes first so that command-line options override it
+    const char *config_path = NULL; int opt, sweep = 0;
+    opterr = 0;
+    while ((opt = getopt_long(argc, argv, short_opts, long_opts, NULL)) != -1) if (opt == 'c') config_path = optarg;
+    if (load_config_file(&config, config_path ? config_path : CONFIG_FILE, config_path != NULL) != 0) return 1;
+    opterr = 1; optind = 1;
+    int idx;
+    while ((opt = getopt_long(argc, argv, short_opts, long_opts, &idx)) != -1) {
+        const char *key = NULL;
+        switch (opt) {
+            case 'c': break;
+            case 'p': key = "port"; break;
+            case 'b': key = "buffer_size"; break;
+            case 'l': key = "listeners"; break;
+            case 'C': key = "client_threads"; break;
+            case 'w': key = "worker_threads"; break;
+            case 'P': key = "pin_cpus"; break;
+            case 'S': key = "sndbuf"; break;
+            case 'R': key = "rcvbuf"; break;
+            case 'x': sweep = 1; break;
+            case 'h': print_usage(argv[0]); return 0;
+            default: print_usage(argv[0]); return 1;
+        }
+        if (key && config_set(&config, key, optarg) != 0) return 1;
+    }
+    config_resolve(&config);
+    signal(SIGPIPE, SIG_IGN); // a client vanishing mid-send must not kill the server
+    if (sweep) return run_sweep();
 
-int main() {
     mkdir(SERVER_CLIENT_FOLDER, 0777);
     mkdir(TMP_UPLOAD_DIR, 0777);
-    client_queue_init(&client_queue);
     task_queue_init(&task_queue);
-    pthread_t accept_thread;
-    pthread_create(&accept_thread, NULL, accept_thread_func, NULL);
-    pthread_t cthreads[CLIENT_THREADPOOL_SIZE];
-    for (int i=0;i<CLIENT_THREADPOOL_SIZE;i++) pthread_create(&cthreads[i], NULL, client_thread_func, NULL);
-    pthread_t wthreads[WORKER_THREADPOOL_SIZE];
-    for (int i=0;i<WORKER_THREADPOOL_SIZE;i++) pthread_create(&wthreads[i], NULL, worker_thread_func, NULL);
-    pthread_join(accept_thread, NULL);
+    client_queue_init(&overflow_queue);
+
+    if (port_in_use()) return 1;
+    listener_count = config.listeners;
+    listeners = calloc(listener_count, sizeof(listener_t));
+    if (!listeners) { perror("calloc"); return 1; }
+    for (int i = 0; i < listener_count; i++) {
+        listener_t *l = &listeners[i];
+        l->id = i;
+        l->cpu = pin_cpu_for(i);
+        l->fd = open_listen_socket();
+        if (l->fd < 0) return 1;
+        client_queue_init(&l->queue);
+        l->idle = 0;
+        pthread_mutex_init(&l->free_mutex, NULL);
+    }
+    printf("[server] listening on %d with %d listener(s), %d client threads each, %d workers, %zu byte buffers\n",
+           config.port, listener_count, config.client_threads, config.worker_threads, config.buffer_size);
+    fflush(stdout);
+
+    pthread_t log_thread;
+    pthread_create(&log_thread, NULL, conn_log_thread_func, NULL);
+    for (int i = 0; i < config.worker_threads; i++) {
+        pthread_t t;
+        pthread_create(&t, NULL, worker_thread_func, (void *)(intptr_t)pin_cpu_for(i));
+    }
+    pthread_t *accept_threads = calloc(listener_count, sizeof(pthread_t));
+    for (int i = 0; i < listener_count; i++) {
+        for (int j = 0; j < config.client_threads; j++) { pthread_t t; pthread_create(&t, NULL, client_thread_func, &listeners[i]); }
+        pthread_create(&accept_threads[i], NULL, accept_thread_func, &listeners[i]);
+    }
+    for (int i = 0; i < listener_count; i++) pthread_join(accept_threads[i], NULL);
     return 0;
-}
\ No newline at end of file
+}